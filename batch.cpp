@@ -0,0 +1,370 @@
+/* Compile: make batch
+ * Usage: ./batch (-f <multigraph file> | -l <manifest>) -o <output> -n <num_threads>
+ *
+ * Computes the MSTs of many small graphs in one process. The graphs come
+ * either from a multigraph file, where graphs in the usual input format
+ * (header line "n m maxWeight" followed by m edges) are concatenated back to
+ * back, or from a manifest listing one graph file per line. Graph ids are the
+ * 0-based positions of the graphs in that file or list.
+ *
+ * Each worker computes one graph at a time with a sequential Kruskal, reusing
+ * its edge, union-find and output buffers across graphs. Workers start with a
+ * contiguous range of graph ids and, once theirs is drained, steal the back
+ * half of another worker's range. Results are appended to the single output
+ * file as each graph finishes, one block per graph:
+ *
+ *   graph <id> <n> <number of tree edges> <mst weight>
+ *   <v1> <v2> <w>        (one line per tree edge)
+ *
+ * Disconnected graphs get their minimum spanning forest.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <bits/stdc++.h>
+#include <omp.h>
+#include <chrono>
+#include "spanning_forest.h"
+
+/* A contiguous range [head, tail) of graph ids. The owner takes ids from the
+ * head, thieves take the back half. */
+typedef struct worker_queue {
+	omp_lock_t lock;
+	unsigned int head;
+	unsigned int tail;
+} worker_queue_t;
+
+/* Buffers each worker reuses from one graph to the next */
+typedef struct worker_buffers {
+	std::vector<char> file;
+	std::vector<edge_t> edges;
+	std::vector<unsigned int> parent;
+	std::vector<unsigned char> rank;
+	std::vector<edge_t> forest;
+	std::string out;
+} worker_buffers_t;
+
+std::vector<char> multigraph;            // contents of the multigraph file
+std::vector<std::pair<size_t, size_t>> graphSpans; // [start, end) of each graph in multigraph
+std::vector<std::string> graphFiles;     // graph files listed in the manifest
+unsigned int numGraphs;
+
+std::vector<worker_queue_t> queues;
+omp_lock_t outputLock;
+FILE *output;
+
+/* @brief Reads a whole file into buf, returning false if it cannot be opened */
+bool readFile(const char *filename, std::vector<char> &buf){
+	FILE *f = fopen(filename, "rb");
+	if(!f){
+		return false;
+	}
+	buf.clear();
+	char chunk[1 << 16];
+	size_t got;
+	while((got = fread(chunk, 1, sizeof(chunk), f)) > 0){
+		buf.insert(buf.end(), chunk, chunk + got);
+	}
+	fclose(f);
+	buf.push_back('\0');
+	return true;
+}
+
+/* @brief Returns the start of the line after p, or end */
+const char *nextLine(const char *p, const char *end){
+	const char *nl = (const char *)memchr(p, '\n', end - p);
+	return nl ? nl + 1 : end;
+}
+
+/* @brief Skips blank lines starting at p */
+const char *skipBlank(const char *p, const char *end){
+	while(p < end){
+		const char *q = p;
+		while(q < end && (*q == ' ' || *q == '\t' || *q == '\r')){
+			q++;
+		}
+		if(q < end && *q != '\n' && *q != '\0'){
+			return p;
+		}
+		p = nextLine(p, end);
+	}
+	return end;
+}
+
+/* @brief Splits the multigraph file into one span per graph using the edge
+ * count of each header line */
+void indexMultigraph(const char *inputFilename){
+	if(!readFile(inputFilename, multigraph)){
+		fprintf(stderr, "Unable to open file: %s\n", inputFilename);
+		exit(EXIT_FAILURE);
+	}
+	const char *base = multigraph.data();
+	const char *end = base + multigraph.size() - 1;
+	const char *p = skipBlank(base, end);
+	while(p < end){
+		// the header is "n m maxWeight"; only m is needed to find the next graph
+		char *next;
+		strtoul(p, &next, 10);
+		unsigned long m = strtoul(next, &next, 10);
+		if(next == p || next > end){
+			fprintf(stderr, "Graph %zu in %s has a malformed header\n", graphSpans.size(), inputFilename);
+			exit(EXIT_FAILURE);
+		}
+		const char *start = p;
+		p = nextLine(p, end);
+		for(unsigned long i = 0; i < m && p < end; i++){
+			p = nextLine(p, end);
+		}
+		graphSpans.push_back(std::make_pair(start - base, p - base));
+		p = skipBlank(p, end);
+	}
+	numGraphs = graphSpans.size();
+}
+
+/* @brief Reads the list of graph files from the manifest */
+void readManifest(const char *manifestFilename){
+	FILE *manifest = fopen(manifestFilename, "r");
+	if(!manifest){
+		fprintf(stderr, "Unable to open file: %s\n", manifestFilename);
+		exit(EXIT_FAILURE);
+	}
+	char line[4096];
+	while(fgets(line, sizeof(line), manifest) != NULL){
+		size_t len = strcspn(line, "\r\n");
+		line[len] = '\0';
+		if(len > 0){
+			graphFiles.push_back(line);
+		}
+	}
+	fclose(manifest);
+	numGraphs = graphFiles.size();
+}
+
+/* @brief Parses one graph from text into the worker's edge buffer */
+bool parseGraph(const char *p, const char *end, unsigned int *n, worker_buffers_t *buf){
+	char *next;
+	unsigned long fields[3];
+	for(int f = 0; f < 3; f++){
+		fields[f] = strtoul(p, &next, 10);
+		if(next == p || next > end){
+			return false;
+		}
+		p = next;
+	}
+	*n = fields[0];
+	unsigned long m = fields[1];
+	// every edge line takes at least "0 0 0\n", so a larger m is malformed and
+	// must not be allocated
+	if(fields[0] > UINT_MAX || m > (unsigned long)(end - p + 1) / 6){
+		return false;
+	}
+
+	buf->edges.resize(m);
+	for(unsigned long i = 0; i < m; i++){
+		long values[3];
+		for(int f = 0; f < 3; f++){
+			values[f] = strtol(p, &next, 10);
+			if(next == p || next > end){
+				return false;
+			}
+			p = next;
+		}
+		if(values[0] < 0 || values[1] < 0 || (unsigned long)values[0] >= *n || (unsigned long)values[1] >= *n){
+			return false;
+		}
+		buf->edges[i].v1 = values[0];
+		buf->edges[i].v2 = values[1];
+		buf->edges[i].w = values[2];
+	}
+	return true;
+}
+
+/* @brief Computes the MST of the graph in the worker's buffers with Kruskal's
+ * algorithm and appends its output block to buf->out */
+void computeMST(unsigned int id, unsigned int n, worker_buffers_t *buf){
+	std::vector<edge_t> &edges = buf->edges;
+	std::sort(edges.begin(), edges.end(), [](const edge_t &a, const edge_t &b){
+		return a.w < b.w;
+	});
+	long long mstWeight = spanningForest(edges.data(), edges.size(), n, std::vector<char>(),
+			buf->parent, buf->rank, buf->forest);
+
+	char line[96];
+	snprintf(line, sizeof(line), "graph %u %u %zu %lld\n", id, n, buf->forest.size(), mstWeight);
+	buf->out += line;
+	for(const edge_t &e : buf->forest){
+		snprintf(line, sizeof(line), "%u %u %d\n", e.v1, e.v2, e.w);
+		buf->out += line;
+	}
+}
+
+/* @brief Loads and solves one graph, returning false if it is malformed */
+bool processGraph(unsigned int id, worker_buffers_t *buf){
+	const char *p;
+	const char *end;
+	if(!graphFiles.empty()){
+		if(!readFile(graphFiles[id].c_str(), buf->file)){
+			fprintf(stderr, "Unable to open file: %s\n", graphFiles[id].c_str());
+			return false;
+		}
+		p = buf->file.data();
+		end = p + buf->file.size() - 1;
+	} else {
+		p = multigraph.data() + graphSpans[id].first;
+		end = multigraph.data() + graphSpans[id].second;
+	}
+
+	unsigned int n;
+	if(!parseGraph(p, end, &n, buf)){
+		fprintf(stderr, "Graph %u is formatted incorrectly\n", id);
+		return false;
+	}
+	computeMST(id, n, buf);
+	return true;
+}
+
+/* @brief Takes the next graph id from the worker's own range */
+bool popOwn(unsigned int worker, unsigned int *id){
+	worker_queue_t &q = queues[worker];
+	bool found = false;
+	omp_set_lock(&q.lock);
+	if(q.head < q.tail){
+		*id = q.head++;
+		found = true;
+	}
+	omp_unset_lock(&q.lock);
+	return found;
+}
+
+/* @brief Moves the back half of another worker's range into this worker's
+ * range, returning false once every range is empty */
+bool steal(unsigned int worker){
+	unsigned int numWorkers = queues.size();
+	for(unsigned int k = 1; k < numWorkers; k++){
+		worker_queue_t &victim = queues[(worker + k) % numWorkers];
+		unsigned int head = 0, tail = 0;
+		omp_set_lock(&victim.lock);
+		if(victim.head < victim.tail){
+			unsigned int remaining = victim.tail - victim.head;
+			tail = victim.tail;
+			head = tail - (remaining + 1) / 2;
+			victim.tail = head;
+		}
+		omp_unset_lock(&victim.lock);
+
+		if(head < tail){
+			worker_queue_t &own = queues[worker];
+			omp_set_lock(&own.lock);
+			own.head = head;
+			own.tail = tail;
+			omp_unset_lock(&own.lock);
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char *argv[]){
+	using namespace std::chrono;
+	typedef std::chrono::high_resolution_clock Clock;
+	typedef std::chrono::duration<double> dsec;
+
+	int opt;
+	char *inputFilename = NULL;
+	char *manifestFilename = NULL;
+	char *outputFilename = NULL;
+	int num_threads = 1;
+
+	while((opt = getopt(argc, argv, "f:l:o:n:")) != -1){
+		switch(opt){
+			case 'f':
+				inputFilename = optarg;
+				break;
+			case 'l':
+				manifestFilename = optarg;
+				break;
+			case 'o':
+				outputFilename = optarg;
+				break;
+			case 'n':
+				num_threads = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s (-f <multigraph file> | -l <manifest>) -o <output> -n <num_threads>\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if((inputFilename == NULL) == (manifestFilename == NULL) || outputFilename == NULL){
+		fprintf(stderr, "Exactly one of -f and -l, and an output filename, are required\n");
+		exit(EXIT_FAILURE);
+	}
+	if(num_threads < 1){
+		num_threads = 1;
+	}
+
+	auto compute_start = Clock::now();
+	if(inputFilename != NULL){
+		indexMultigraph(inputFilename);
+	} else {
+		readManifest(manifestFilename);
+	}
+
+	output = fopen(outputFilename, "w");
+	if(!output){
+		fprintf(stderr, "Unable to open output file\n");
+		exit(EXIT_FAILURE);
+	}
+	omp_init_lock(&outputLock);
+
+	// every worker starts with a contiguous block of graph ids
+	queues.resize(num_threads);
+	for(int t = 0; t < num_threads; t++){
+		omp_init_lock(&queues[t].lock);
+		queues[t].head = (unsigned long long)numGraphs * t / num_threads;
+		queues[t].tail = (unsigned long long)numGraphs * (t + 1) / num_threads;
+	}
+
+	unsigned int failed = 0;
+	unsigned int steals = 0;
+	#pragma omp parallel num_threads (num_threads) reduction(+:failed, steals)
+	{
+		unsigned int worker = omp_get_thread_num();
+		worker_buffers_t buf;
+		unsigned int id;
+		while(true){
+			if(!popOwn(worker, &id)){
+				if(!steal(worker)){
+					break;
+				}
+				steals++;
+				continue;
+			}
+
+			buf.out.clear();
+			if(!processGraph(id, &buf)){
+				failed++;
+				continue;
+			}
+
+			omp_set_lock(&outputLock);
+			fwrite(buf.out.data(), 1, buf.out.size(), output);
+			omp_unset_lock(&outputLock);
+		}
+	}
+
+	fclose(output);
+	for(int t = 0; t < num_threads; t++){
+		omp_destroy_lock(&queues[t].lock);
+	}
+	omp_destroy_lock(&outputLock);
+
+	double compute_time = duration_cast<dsec>(Clock::now() - compute_start).count();
+	printf("Computation Time: %lf.\n", compute_time);
+	printf("Graphs: %u (%u failed), %u steals.\n", numGraphs, failed, steals);
+	printf("Throughput: %.1lf graphs/s.\n", compute_time > 0 ? numGraphs / compute_time : 0.0);
+
+	return failed == 0 ? 0 : EXIT_FAILURE;
+}
@@ -1,13 +1,33 @@
 /* Run make
- * Usage: ./boruvka -f <filename> -n <num_threads>
+ * Usage: ./boruvka -f <filename> -n <num_threads> [-t] [-c] [-r bfs|rcm|degree] [-k <clusters>]
+ *
+ * -c canonicalizes the input before the MST computation: self-loops are
+ * dropped and only the lightest edge between each pair of vertices is kept.
+ *
+ * -r relabels the vertices in the given order before the MST computation so
+ * that parent[] lookups stay local; the output uses the original ids.
+ *
+ * -k computes a single-linkage clustering with the given number of clusters and
+ * writes a cluster label per vertex to clusters_n_m_k.txt instead of the MST.
+ *
+ * -t enables the topology-aware mode: OpenMP threads are pinned to the CPUs of
+ * the NUMA nodes listed under /sys/devices/system/node, each thread scans a
+ * contiguous block of the edge array that it first-touched itself, and the
+ * vertex-indexed arrays and the workspace are interleaved page by page across
+ * the nodes. Machines without NUMA information fall back to a single node.
  *
  */
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
 #include <bits/stdc++.h>
 #include <omp.h>
 #include <chrono> 
+#include "workspace.h"
+#include "canonicalize.h"
+#include "reorder.h"
 
 typedef struct edge {
 	unsigned int v1;
@@ -19,11 +39,193 @@ unsigned int n;
 unsigned int m;
 int maxWeight;
 edge_t *edges;
-std::vector<std::pair<unsigned int, unsigned int>> parent;
+std::pair<unsigned int, unsigned int> *parent;
+workspace_t workspace;
 unsigned int nsets;
 std::vector<edge> mst;
 unsigned int mstWeight;
 
+bool topologyAware = false;
+bool dedupeInput = false;
+int vertexOrder = ORDER_NONE;
+unsigned int numClusters = 0;            // 0 computes the full MST
+std::vector<unsigned int> oldId;         // original id of each relabeled vertex
+std::vector<std::vector<int>> nodeCpus;  // CPUs belonging to each NUMA node
+std::vector<unsigned int> threadNode;    // NUMA node each OpenMP thread is pinned to
+std::vector<double> threadScanTime;      // seconds each thread spent scanning edges
+std::vector<double> threadScanBytes;     // bytes of edges each thread scanned
+
+/* @brief Parses a sysfs cpulist such as "0-3,8-11" into a list of CPU ids */
+std::vector<int> parseCpuList(const char *list){
+	std::vector<int> cpus;
+	const char *p = list;
+	while(*p != '\0' && *p != '\n'){
+		char *end;
+		long lo = strtol(p, &end, 10);
+		if(end == p){
+			break;
+		}
+		long hi = lo;
+		p = end;
+		if(*p == '-'){
+			hi = strtol(p + 1, &end, 10);
+			p = end;
+		}
+		for(long c = lo; c <= hi; c++){
+			cpus.push_back((int)c);
+		}
+		if(*p == ','){
+			p++;
+		}
+	}
+	return cpus;
+}
+
+/* @brief Reads the NUMA topology from sysfs, falling back to a single node
+ * holding every online CPU */
+void readTopology(){
+	for(unsigned int node = 0; ; node++){
+		char path[80];
+		sprintf(path, "/sys/devices/system/node/node%u/cpulist", node);
+		FILE *f = fopen(path, "r");
+		if(!f){
+			break;
+		}
+		char list[4096];
+		if(fgets(list, sizeof(list), f) != NULL){
+			std::vector<int> cpus = parseCpuList(list);
+			// memory-only nodes have no CPUs to pin threads to
+			if(!cpus.empty()){
+				nodeCpus.push_back(cpus);
+			}
+		}
+		fclose(f);
+	}
+
+	if(nodeCpus.empty()){
+		std::vector<int> cpus;
+		long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		for(long c = 0; c < ncpus; c++){
+			cpus.push_back((int)c);
+		}
+		nodeCpus.push_back(cpus);
+	}
+}
+
+/* @brief Assigns threads to NUMA nodes in contiguous groups and pins each
+ * thread to a CPU of its node. Thread t always scans the t-th block of edges,
+ * so neighbouring blocks end up on the same node. */
+void pinThreads(unsigned int num_threads){
+	unsigned int numNodes = nodeCpus.size();
+	threadNode.assign(num_threads, 0);
+	threadScanTime.assign(num_threads, 0);
+	threadScanBytes.assign(num_threads, 0);
+
+	#pragma omp parallel num_threads (num_threads)
+	{
+		unsigned int threadId = omp_get_thread_num();
+		unsigned int node = (unsigned long long)threadId * numNodes / num_threads;
+		// index of this thread among the threads sharing its node
+		unsigned int firstOnNode = ((unsigned long long)node * num_threads + numNodes - 1) / numNodes;
+		const std::vector<int> &cpus = nodeCpus[node];
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpus[(threadId - firstOnNode) % cpus.size()], &set);
+		if(sched_setaffinity(0, sizeof(set), &set) != 0){
+			fprintf(stderr, "Unable to pin thread %u to node %u\n", threadId, node);
+		}
+		threadNode[threadId] = node;
+	}
+}
+
+/* @brief Returns the [start, end) block of edges scanned by the given thread */
+void edgeBlock(unsigned int threadId, unsigned int num_threads, unsigned int *start, unsigned int *end){
+	*start = (unsigned long long)m * threadId / num_threads;
+	*end = (unsigned long long)m * (threadId + 1) / num_threads;
+}
+
+/* @brief Allocates untouched memory for a vertex-indexed array. In topology-aware
+ * mode each page is first touched by a thread on node (page % numNodes), which
+ * interleaves the array across the nodes. */
+void *allocVertexArray(size_t bytes){
+	void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(mem == MAP_FAILED){
+		fprintf(stderr, "Unable to allocate %zu bytes\n", bytes);
+		exit(EXIT_FAILURE);
+	}
+	if(!topologyAware){
+		return mem;
+	}
+
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t numPages = (bytes + pageSize - 1) / pageSize;
+	unsigned int numNodes = nodeCpus.size();
+	unsigned int num_threads = threadNode.size();
+	char *pages = (char *)mem;
+
+	#pragma omp parallel num_threads (num_threads)
+	{
+		unsigned int threadId = omp_get_thread_num();
+		unsigned int node = threadNode[threadId];
+		// the threads of a node share the pages of that node between them
+		unsigned int rank = 0, size = 0;
+		for(unsigned int t = 0; t < num_threads; t++){
+			if(threadNode[t] == node){
+				if(t < threadId){
+					rank++;
+				}
+				size++;
+			}
+		}
+		for(size_t page = node + (size_t)rank * numNodes; page < numPages; page += (size_t)size * numNodes){
+			pages[page * pageSize] = 0;
+		}
+	}
+	return mem;
+}
+
+/* @brief Moves the edge array into memory first-touched by the threads that
+ * will scan each block, so every block lives on the node that reads it */
+void placeEdges(unsigned int num_threads){
+	size_t bytes = std::max((size_t)m, (size_t)1) * sizeof(edge_t);
+	void *mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(mem == MAP_FAILED){
+		fprintf(stderr, "Unable to allocate %zu bytes\n", bytes);
+		exit(EXIT_FAILURE);
+	}
+	edge_t *placed = (edge_t *)mem;
+
+	#pragma omp parallel num_threads (num_threads)
+	{
+		unsigned int start, end;
+		edgeBlock(omp_get_thread_num(), num_threads, &start, &end);
+		memcpy(&placed[start], &edges[start], (size_t)(end - start) * sizeof(edge_t));
+	}
+
+	free(edges);
+	edges = placed;
+}
+
+/* @brief Prints the edge scan bandwidth achieved by the threads of each node */
+void printNodeStats(){
+	for(unsigned int node = 0; node < nodeCpus.size(); node++){
+		unsigned int threads = 0;
+		double bytes = 0;
+		double bandwidth = 0;
+		for(unsigned int t = 0; t < threadNode.size(); t++){
+			if(threadNode[t] == node){
+				threads++;
+				bytes += threadScanBytes[t];
+				if(threadScanTime[t] > 0){
+					bandwidth += threadScanBytes[t] / threadScanTime[t];
+				}
+			}
+		}
+		printf("Node %u: %u threads, %.2lf MB scanned, %.2lf GB/s.\n", node, threads, bytes / 1e6, bandwidth / 1e9);
+	}
+}
+
 /* @brief Returns supervertex for given vertex */
 unsigned int findParent(unsigned int v){
 	if(parent[v].first == v){
@@ -51,12 +253,18 @@ void unionVerts(unsigned int v1, unsigned int v2){
 
 /* @brief Computes the minimum spanning tree using Boruvka's algorithm */
 void findMST(unsigned int num_threads){
-	while(nsets > 1){
-		std::vector<unsigned int> cheapest(n, UINT_MAX);
-		omp_lock_t lock[n];
+	size_t mark = workspaceMark(&workspace);
+	omp_lock_t *lock = (omp_lock_t *)workspaceAlloc(&workspace, (size_t)n * sizeof(omp_lock_t));
+	for(unsigned int i=0; i < n; i++){
+		omp_init_lock(&(lock[i]));
+	}
 
-		for(unsigned int i=0; i < n; i++){
-			omp_init_lock(&(lock[i]));
+	while(nsets > 1 && m > 0){
+		size_t roundMark = workspaceMark(&workspace);
+		unsigned int *cheapest = (unsigned int *)workspaceAlloc(&workspace, (size_t)n * sizeof(unsigned int));
+		#pragma omp parallel for num_threads (num_threads)
+		for(unsigned int i = 0; i < n; i++){
+			cheapest[i] = UINT_MAX;
 		}
 
 		// Iterates through all the edges and updates the cheapest edges for the
@@ -64,7 +272,16 @@ void findMST(unsigned int num_threads){
 		#pragma omp parallel num_threads (num_threads)
 		{
 			unsigned int threadId = omp_get_thread_num();
-			for(unsigned int i = threadId % m; i < m; i += num_threads){
+			unsigned int start = threadId % m;
+			unsigned int end = m;
+			unsigned int stride = num_threads;
+			double scan_start = omp_get_wtime();
+			if(topologyAware){
+				// scan the block this thread placed on its own node
+				edgeBlock(threadId, num_threads, &start, &end);
+				stride = 1;
+			}
+			for(unsigned int i = start; i < end; i += stride){
 				unsigned int v1 = edges[i].v1;
 				unsigned int v2 = edges[i].v2;
 				int w = edges[i].w;
@@ -92,9 +309,14 @@ void findMST(unsigned int num_threads){
 					//}
 				}
 			}
+			if(topologyAware){
+				threadScanTime[threadId] += omp_get_wtime() - scan_start;
+				threadScanBytes[threadId] += (double)(end - start) * sizeof(edge_t);
+			}
 		}	
 
 		// For each vertex, add the cheapest edge to the MST, if possible
+		unsigned int added = 0;
 		for(unsigned int j = 0; j < n; j++){
 			unsigned int i = cheapest[j];
 			if(i != UINT_MAX){
@@ -111,6 +333,7 @@ void findMST(unsigned int num_threads){
 					mstWeight += w;
 					unionVerts(v1, v2);
 					nsets--;
+					added++;
 					if(nsets == 0){
 						break;
 					}
@@ -118,10 +341,43 @@ void findMST(unsigned int num_threads){
 			}
 		}
 
-		for(unsigned int i=0; i < n; i++){
-			omp_destroy_lock(&(lock[i]));
+		workspaceReset(&workspace, roundMark);
+
+		// no component has an outgoing edge left, so the graph is disconnected
+		// and the spanning forest is complete
+		if(added == 0){
+			break;
 		}
+	}
 
+	for(unsigned int i=0; i < n; i++){
+		omp_destroy_lock(&(lock[i]));
+	}
+	workspaceReset(&workspace, mark);
+}
+
+/* @brief Groups the vertices into numClusters single-linkage clusters.
+ *
+ * Stopping the Boruvka rounds at numClusters components is not enough, since a
+ * round can add an MST edge heavier than ones a later round would add. The k-1
+ * heaviest tree edges are the ones to leave out, so the spanning forest is
+ * replayed in weight order through a fresh union-find until numClusters sets
+ * remain. This only touches the n-1 tree edges, not the edge list.
+ */
+void findClusters(){
+	std::sort(mst.begin(), mst.end(), [](const edge_t &a, const edge_t &b){
+		return a.w < b.w;
+	});
+	for(unsigned int i = 0; i < n; i++){
+		parent[i] = std::make_pair(i, 1);
+	}
+	nsets = n;
+	for(auto e : mst){
+		if(nsets <= numClusters){
+			break;
+		}
+		unionVerts(e.v1, e.v2);
+		nsets--;
 	}
 }
 
@@ -151,10 +407,16 @@ void readInput(char *inputFilename){
 	}
 
 	// initialize vertex sets
+	parent = (std::pair<unsigned int, unsigned int> *)allocVertexArray(std::max(n, 1u) * sizeof(*parent));
 	for(unsigned int i = 0; i < n; i++){
-		parent.push_back(std::make_pair(i, 1));
+		parent[i] = std::make_pair(i, 1);
 	}
 	nsets = n;
+	mst.reserve(n);
+
+	// scratch for the locks and the per-round cheapest edges
+	size_t workspaceSize = workspaceBytes((size_t)n * (sizeof(omp_lock_t) + sizeof(unsigned int)), 2);
+	workspaceInit(&workspace, allocVertexArray(workspaceSize), workspaceSize);
 }
 
 /* @brief Writes MST and weight to output file */
@@ -171,12 +433,46 @@ void writeOutput(){
 	// write mst to output file
 	fprintf(output, "%i %i %i\n", n, m, mstWeight);
 	for( auto e : mst ){
+		if(!oldId.empty()){
+			e.v1 = oldId[e.v1];
+			e.v2 = oldId[e.v2];
+		}
 		fprintf(output, "%i %i %d\n", e.v1, e.v2, e.w);
 	}
 
 	fclose(output);
 }
 
+/* @brief Writes the cluster label of every vertex to the output file. The label
+ * is the vertex that represents the cluster in the union-find. */
+void writeClusters(){
+	char outputFilename[80];
+	sprintf(outputFilename, "clusters_%i_%i_%u.txt", n, m, numClusters);
+
+	FILE *output = fopen(outputFilename, "w");
+	if(!output){
+		fprintf(stderr, "Unable to open output file\n");
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<unsigned int> label(n);
+	for(unsigned int v = 0; v < n; v++){
+		unsigned int p = findParent(v);
+		if(!oldId.empty()){
+			label[oldId[v]] = oldId[p];
+		} else {
+			label[v] = p;
+		}
+	}
+
+	fprintf(output, "%i %u\n", n, nsets);
+	for(unsigned int v = 0; v < n; v++){
+		fprintf(output, "%u %u\n", v, label[v]);
+	}
+
+	fclose(output);
+}
+
 int main(int argc, char *argv[]){
 	using namespace std::chrono;
 	typedef std::chrono::high_resolution_clock Clock;
@@ -186,7 +482,7 @@ int main(int argc, char *argv[]){
 	char *inputFilename = NULL;
 	int num_threads = 1;
 
-	while((opt = getopt(argc, argv, "f:n:")) != -1){
+	while((opt = getopt(argc, argv, "f:n:tcr:k:")) != -1){
 		switch(opt){
 			case 'f':
 				inputFilename = optarg;
@@ -194,8 +490,24 @@ int main(int argc, char *argv[]){
 			case 'n':
 				num_threads = atoi(optarg);
 				break;
+			case 't':
+				topologyAware = true;
+				break;
+			case 'c':
+				dedupeInput = true;
+				break;
+			case 'r':
+				vertexOrder = parseOrder(optarg);
+				break;
+			case 'k':
+				if(atoi(optarg) < 1){
+					fprintf(stderr, "Number of clusters must be positive\n");
+					exit(EXIT_FAILURE);
+				}
+				numClusters = atoi(optarg);
+				break;
 			default:
-				fprintf(stderr, "Usage: %s -f <filename> -n <num_threads>\n", argv[0]);
+				fprintf(stderr, "Usage: %s -f <filename> -n <num_threads> [-t] [-c] [-r bfs|rcm|degree] [-k <clusters>]\n", argv[0]);
 				exit(EXIT_FAILURE);
 		}
 	}
@@ -205,13 +517,48 @@ int main(int argc, char *argv[]){
 		exit(EXIT_FAILURE);
 	}
 
+	if(topologyAware){
+		readTopology();
+		pinThreads(num_threads);
+		printf("Topology: %zu NUMA node(s).\n", nodeCpus.size());
+	}
+
 	readInput(inputFilename);
+	if(dedupeInput){
+		auto canon_start = Clock::now();
+		canon_stats_t stats;
+		unsigned int inputM = m;
+		m = canonicalizeEdges(edges, m, &edge_t::v1, &edge_t::v2, &edge_t::w, num_threads, &stats);
+		printCanonStats(&stats, inputM, m, duration_cast<dsec>(Clock::now() - canon_start).count());
+	}
+	if(vertexOrder != ORDER_NONE){
+		reorder_stats_t stats;
+		oldId = reorderVertices(edges, m, n, &edge_t::v1, &edge_t::v2, vertexOrder, num_threads, &stats);
+		printReorderStats(&stats);
+	}
+	if(topologyAware){
+		placeEdges(num_threads);
+	}
 	auto compute_start = Clock::now();
 	double compute_time = 0;
 	findMST(num_threads);
+	if(numClusters > 0){
+		findClusters();
+	}
 	compute_time += duration_cast<dsec>(Clock::now() - compute_start).count();
 	printf("Computation Time: %lf.\n", compute_time);
-	writeOutput();
+	printPeakMemory(&workspace);
+	if(topologyAware){
+		printNodeStats();
+	}
+	if(numClusters > 0){
+		if(nsets > numClusters){
+			printf("Graph has %u components, more than the %u clusters requested.\n", nsets, numClusters);
+		}
+		writeClusters();
+	} else {
+		writeOutput();
+	}
 
 	return 0;
 }
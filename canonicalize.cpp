@@ -0,0 +1,99 @@
+/* Compile: make canonicalize
+ * Usage: ./canonicalize -f <input filename> -o <output filename> -n <num_threads>
+ *
+ * Reads a graph in the input format used by boruvka and kruskal, drops
+ * self-loops, keeps only the lightest edge between each pair of vertices, and
+ * writes the cleaned graph to the output file in the same format. The header
+ * line of the output carries the new edge count.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <omp.h>
+#include <chrono>
+#include "canonicalize.h"
+
+typedef struct edge {
+	unsigned int v1;
+	unsigned int v2;
+	int w;
+} edge_t;
+
+int main(int argc, char *argv[]){
+	using namespace std::chrono;
+	typedef std::chrono::high_resolution_clock Clock;
+	typedef std::chrono::duration<double> dsec;
+
+	int opt;
+	char *inputFilename = NULL;
+	char *outputFilename = NULL;
+	int num_threads = 1;
+
+	while((opt = getopt(argc, argv, "f:o:n:")) != -1){
+		switch(opt){
+			case 'f':
+				inputFilename = optarg;
+				break;
+			case 'o':
+				outputFilename = optarg;
+				break;
+			case 'n':
+				num_threads = atoi(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s -f <input filename> -o <output filename> -n <num_threads>\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if(inputFilename == NULL || outputFilename == NULL){
+		fprintf(stderr, "Input and output filenames are required\n");
+		exit(EXIT_FAILURE);
+	}
+
+	FILE *input = fopen(inputFilename, "r");
+	if(!input){
+		fprintf(stderr, "Unable to open file: %s\n", inputFilename);
+		exit(EXIT_FAILURE);
+	}
+
+	unsigned int n, m;
+	int maxWeight;
+	if(fscanf(input, "%u %u %d\n", &n, &m, &maxWeight) != 3){
+		fprintf(stderr, "Input file %s is formatted incorrectly\n", inputFilename);
+		exit(EXIT_FAILURE);
+	}
+
+	edge_t *edges = (edge_t *)calloc(m, sizeof(edge_t));
+	if(m > 0 && edges == NULL){
+		fprintf(stderr, "Unable to allocate %u edges\n", m);
+		exit(EXIT_FAILURE);
+	}
+	for(unsigned int i = 0; i < m; i++){
+		if(fscanf(input, "%u %u %d\n", &edges[i].v1, &edges[i].v2, &edges[i].w) != 3){
+			fprintf(stderr, "Input file %s is formatted incorrectly\n", inputFilename);
+			exit(EXIT_FAILURE);
+		}
+	}
+	fclose(input);
+
+	auto canon_start = Clock::now();
+	canon_stats_t stats;
+	unsigned int newM = canonicalizeEdges(edges, m, &edge_t::v1, &edge_t::v2, &edge_t::w, num_threads, &stats);
+	printCanonStats(&stats, m, newM, duration_cast<dsec>(Clock::now() - canon_start).count());
+
+	FILE *output = fopen(outputFilename, "w");
+	if(!output){
+		fprintf(stderr, "Unable to open output file\n");
+		exit(EXIT_FAILURE);
+	}
+	fprintf(output, "%u %u %d\n", n, newM, maxWeight);
+	for(unsigned int i = 0; i < newM; i++){
+		fprintf(output, "%u %u %d\n", edges[i].v1, edges[i].v2, edges[i].w);
+	}
+	fclose(output);
+	free(edges);
+
+	return 0;
+}
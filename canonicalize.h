@@ -0,0 +1,115 @@
+/* Input canonicalization shared by the MST engines and the canonicalize tool.
+ *
+ * Every edge is normalized so that its first endpoint is the smaller one, the
+ * list is sorted in parallel by (v1, v2, w), and a parallel compaction keeps
+ * only the first edge of each endpoint pair, which is the lightest one.
+ * Self-loops are dropped since they can never be part of a spanning tree.
+ *
+ * The engines name their endpoint fields differently, so the fields are passed
+ * in as member pointers.
+ *
+ */
+#ifndef CANONICALIZE_H
+#define CANONICALIZE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+#include <parallel/algorithm>
+#include <omp.h>
+
+typedef struct canon_stats {
+	size_t selfLoops;
+	size_t duplicates;
+} canon_stats_t;
+
+/* @brief Canonicalizes edges[0, m) in place and returns the new edge count */
+template <typename Edge, typename Vertex>
+size_t canonicalizeEdges(Edge *edges, size_t m, Vertex Edge::*v1, Vertex Edge::*v2,
+		int Edge::*w, unsigned int num_threads, canon_stats_t *stats){
+	if(num_threads < 1){
+		num_threads = 1;
+	}
+	stats->selfLoops = 0;
+	stats->duplicates = 0;
+	if(m == 0){
+		return 0;
+	}
+
+	// normalize every edge to (min, max) order
+	#pragma omp parallel for num_threads (num_threads)
+	for(size_t i = 0; i < m; i++){
+		if(edges[i].*v1 > edges[i].*v2){
+			std::swap(edges[i].*v1, edges[i].*v2);
+		}
+	}
+
+	// group edges by endpoint pair with the lightest edge of each pair first
+	__gnu_parallel::sort(edges, edges + m, [v1, v2, w](const Edge &a, const Edge &b){
+		if(a.*v1 != b.*v1){
+			return a.*v1 < b.*v1;
+		}
+		if(a.*v2 != b.*v2){
+			return a.*v2 < b.*v2;
+		}
+		return a.*w < b.*w;
+	}, __gnu_parallel::default_parallel_tag(num_threads));
+
+	// count the survivors of each thread's chunk, then scatter them to their
+	// final positions
+	std::vector<size_t> kept(num_threads + 1, 0);
+	std::vector<size_t> loops(num_threads, 0);
+	std::vector<Edge> out(m);
+	size_t newM = 0;
+	#pragma omp parallel num_threads (num_threads)
+	{
+		unsigned int threadId = omp_get_thread_num();
+		unsigned int nthreads = omp_get_num_threads();
+		size_t start = m * threadId / nthreads;
+		size_t end = m * (threadId + 1) / nthreads;
+
+		size_t count = 0;
+		for(size_t i = start; i < end; i++){
+			if(edges[i].*v1 == edges[i].*v2){
+				loops[threadId]++;
+			} else if(i == 0 || edges[i].*v1 != edges[i-1].*v1 || edges[i].*v2 != edges[i-1].*v2){
+				count++;
+			}
+		}
+		kept[threadId + 1] = count;
+
+		#pragma omp barrier
+		#pragma omp single
+		{
+			for(unsigned int t = 0; t < nthreads; t++){
+				kept[t + 1] += kept[t];
+			}
+			newM = kept[nthreads];
+		}
+
+		size_t pos = kept[threadId];
+		for(size_t i = start; i < end; i++){
+			if(edges[i].*v1 != edges[i].*v2 &&
+					(i == 0 || edges[i].*v1 != edges[i-1].*v1 || edges[i].*v2 != edges[i-1].*v2)){
+				out[pos++] = edges[i];
+			}
+		}
+	}
+
+	std::copy(out.begin(), out.begin() + newM, edges);
+
+	for(unsigned int t = 0; t < num_threads; t++){
+		stats->selfLoops += loops[t];
+	}
+	stats->duplicates = m - newM - stats->selfLoops;
+	return newM;
+}
+
+/* @brief Prints how many edges canonicalization removed */
+static inline void printCanonStats(const canon_stats_t *stats, size_t before, size_t after, double seconds){
+	printf("Canonicalization: %zu -> %zu edges (%zu self-loops, %zu duplicates removed) in %lf.\n",
+			before, after, stats->selfLoops, stats->duplicates, seconds);
+}
+
+#endif
@@ -1,12 +1,26 @@
-// g++ -fopenmp -o kruskal kruskal.cpp -std=c++11
-// ./kruskalc -f exGraph1.txt
+// make kruskal (or g++ -fopenmp -I. -o kruskal kruskal.cpp -std=c++11)
+// ./kruskal -f exGraph1.txt [-c] [-r bfs|rcm|degree] [-k clusters] [-p]
+// -c drops self-loops and keeps only the lightest of any repeated edges
+// -r relabels vertices in the given order for union-find locality; the output
+//    uses the original ids
+// -k stops after n-k unions and writes a single-linkage cluster label per
+//    vertex to clusters_n_m_k.txt instead of the MST
+// -p pipelines the ingest: blocks of edges are sorted while the file is still
+//    being parsed, and union-find starts on the lightest edges before the final
+//    merge is done (cannot be combined with -c or -r, which need every edge)
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <bits/stdc++.h>
 #include <omp.h>
 #include <chrono>
+#include "workspace.h"
+#include "canonicalize.h"
+#include "reorder.h"
 
+#define PIPELINE_BLOCK 65536 // edges per block handed from the reader to the sorters
+#define PIPELINE_SAMPLES 64 // weights sampled per block to pick merge splitters
+#define PIPELINE_RANGES_PER_THREAD 8 // merge ranges per thread, for balance and an early start
 
 
 typedef struct edge {
@@ -21,6 +35,12 @@ int maxWeight;
 edge *resultList;
 edge *edgeList;
 double globalTime = 0;
+bool dedupeInput = false;
+int vertexOrder = ORDER_NONE;
+std::vector<int> oldId; // original id of each relabeled vertex
+int numClusters = 0; // 0 computes the full MST
+int numResultEdges = 0;
+bool pipelined = false;
 
 int find(int* parentRepList, int vertToFind) {
     if(parentRepList == NULL) {
@@ -51,13 +71,16 @@ void unionVerts(int* parentRepList, int* depthAtVertList, int vert1, int vert2)
 }
 
 
-void merge(edge *edgeList, int start, int mid, int end) {
+// scratch has the same length as edgeList; each merge only uses the
+// [start, end) slice of it, so concurrent merges of disjoint ranges can
+// share the one buffer
+void merge(edge *edgeList, edge *scratch, int start, int mid, int end) {
     int leftLen = mid-start+1;
     int rightLen = end-1-mid;
-    edge *leftPart = (edge*)calloc(leftLen, sizeof(edge));
-    edge *rightPart = (edge*)calloc(rightLen, sizeof(edge));
+    edge *leftPart = &scratch[start];
+    edge *rightPart = &scratch[mid+1];
 
-    // create left and right arrays to merge and populate directly into edgeList
+    // copy left and right parts to scratch to merge and populate directly into edgeList
     for(int i = 0; i < leftLen; i++) {
         leftPart[i] = edgeList[start+i];
     }
@@ -95,7 +118,7 @@ void merge(edge *edgeList, int start, int mid, int end) {
     }
 }
 
-void mergeSortSeq(edge *edgeList, int start, int end) {
+void mergeSortSeq(edge *edgeList, edge *scratch, int start, int end) {
     using namespace std::chrono;
     typedef std::chrono::high_resolution_clock Clock;
     typedef std::chrono::duration<double> dsec;
@@ -104,10 +127,10 @@ void mergeSortSeq(edge *edgeList, int start, int end) {
     }
     int mid = ((end-2)+start)/2;
 
-    mergeSortSeq(edgeList, start, mid+1);
-    mergeSortSeq(edgeList, mid+1, end);
+    mergeSortSeq(edgeList, scratch, start, mid+1);
+    mergeSortSeq(edgeList, scratch, mid+1, end);
     auto compute_start = Clock::now();
-    merge(edgeList, start, mid, end);
+    merge(edgeList, scratch, start, mid, end);
     globalTime += duration_cast<dsec>(Clock::now() - compute_start).count();
 }
 
@@ -116,7 +139,7 @@ void mergeSortSeq(edge *edgeList, int start, int end) {
 // https://web.engr.oregonstate.edu/~mjb/cs575/Handouts/tasks.1pp.pdf
 // (Namely just using tasks to do 2 things at once and single to ensure
 // only 1 thread enqueues the tasks.)
-void mergeSort(edge *edgeList, int start, int end) {
+void mergeSort(edge *edgeList, edge *scratch, int start, int end) {
     using namespace std::chrono;
     typedef std::chrono::high_resolution_clock Clock;
     typedef std::chrono::duration<double> dsec;
@@ -134,20 +157,22 @@ void mergeSort(edge *edgeList, int start, int end) {
             // start 2 parallel tasks to sort 2 halves
             #pragma omp task
             {
-                mergeSort(edgeList, start, mid+1);
+                mergeSort(edgeList, scratch, start, mid+1);
             }
             #pragma omp task
             {
-                mergeSort(edgeList, mid+1, end);
+                mergeSort(edgeList, scratch, mid+1, end);
             }
         }
     }
     auto compute_start = Clock::now();
-    merge(edgeList, start, mid, end); // merge start to mid WITH mid to end
+    merge(edgeList, scratch, start, mid, end); // merge start to mid WITH mid to end
     globalTime += duration_cast<dsec>(Clock::now() - compute_start).count();
 }
 
-void readInput(char *inputFilename) {
+// Opens the input, reads the header and allocates the edge list; the edges
+// themselves are left for the caller to read
+FILE *openInput(char *inputFilename) {
     FILE *input = fopen(inputFilename, "r");
     if(!input){
         fprintf(stderr, "Unable to open file:  %s\n", "hmm");
@@ -169,20 +194,46 @@ void readInput(char *inputFilename) {
         printf("malloc error");
         exit(EXIT_FAILURE);
     }
+    return input;
+}
+
+void readInput(char *inputFilename) {
+    FILE *input = openInput(inputFilename);
 
-    int indexOfEdgeList = 0;
     for(int i = 0; i < m; i++){
-        int inputLine = fscanf(input, "%d %d %d\n", &edgeList[indexOfEdgeList].u, &edgeList[indexOfEdgeList].v, &edgeList[indexOfEdgeList].w);
+        int inputLine = fscanf(input, "%d %d %d\n", &edgeList[i].u, &edgeList[i].v, &edgeList[i].w);
         if(inputLine != 3){
             fprintf(stderr, "Input file %s is formatted incorrectly\n", inputFilename);
             exit(EXIT_FAILURE);
         }
-        indexOfEdgeList += 1;
-        // add opposite edge since this is an undirected graph
-        edgeList[indexOfEdgeList].u = edgeList[indexOfEdgeList-1].v;
-        edgeList[indexOfEdgeList].v = edgeList[indexOfEdgeList-1].u;
-        edgeList[indexOfEdgeList].w = edgeList[indexOfEdgeList-1].w;
-        indexOfEdgeList += 1;
+    }
+    fclose(input);
+
+    if(dedupeInput) {
+        using namespace std::chrono;
+        typedef std::chrono::high_resolution_clock Clock;
+        typedef std::chrono::duration<double> dsec;
+        auto canon_start = Clock::now();
+        canon_stats_t stats;
+        int inputM = m;
+        m = canonicalizeEdges(edgeList, m, &edge::u, &edge::v, &edge::w, omp_get_max_threads(), &stats);
+        printCanonStats(&stats, inputM, m, duration_cast<dsec>(Clock::now() - canon_start).count());
+    }
+
+    if(vertexOrder != ORDER_NONE) {
+        reorder_stats_t stats;
+        oldId = reorderVertices(edgeList, m, n, &edge::u, &edge::v, vertexOrder, omp_get_max_threads(), &stats);
+        printReorderStats(&stats);
+    }
+
+    // add opposite edges since this is an undirected graph; walking backwards
+    // never overwrites an edge that has not been copied yet
+    for(int i = m-1; i >= 0; i--) {
+        edge e = edgeList[i];
+        edgeList[2*i] = e;
+        edgeList[2*i+1].u = e.v;
+        edgeList[2*i+1].v = e.u;
+        edgeList[2*i+1].w = e.w;
     }
 
 }
@@ -200,7 +251,11 @@ void writeOutput() {
     // write mst result to output file
     fprintf(output, "%d %d %d\n", n, m, maxWeight);
 
-    for(int j = 0; j < n-1; j++) {
+    for(int j = 0; j < numResultEdges; j++) {
+        if(!oldId.empty()) {
+            resultList[j].u = oldId[resultList[j].u];
+            resultList[j].v = oldId[resultList[j].v];
+        }
         fprintf(output, "%d %d %d\n", resultList[j].u, resultList[j].v, resultList[j].w);
     }
     fclose(output);
@@ -208,7 +263,221 @@ void writeOutput() {
 
 }
 
+// Cluster labels come straight from the union-find: each vertex is labelled
+// with the representative of its set
+void writeClusters(int* parentRepList, int numSets) {
+    char outputFilename[80];
+    sprintf(outputFilename, "clusters_%d_%d_%d.txt", n, m, numClusters);
+
+    FILE *output = fopen(outputFilename, "w");
+    if(!output){
+        fprintf(stderr, "Unable to open output file\n");
+        exit(EXIT_FAILURE);
+    }
+
+    std::vector<int> label(n);
+    for(int v = 0; v < n; v++) {
+        int p = find(parentRepList, v);
+        if(!oldId.empty()) {
+            label[oldId[v]] = oldId[p];
+        } else {
+            label[v] = p;
+        }
+    }
+
+    fprintf(output, "%d %d\n", n, numSets);
+    for(int v = 0; v < n; v++) {
+        fprintf(output, "%d %d\n", v, label[v]);
+    }
+    fclose(output);
+}
+
+// Adds e to the result list if its endpoints are not yet connected
+void tryUnion(int* parentRepList, int* depthAtVertList, const edge &e, int *numEdgesSoFar) {
+    int parent1 = find(parentRepList, e.u);
+    int parent2 = find(parentRepList, e.v);
+
+    // Ensure connecting e.u and e.v doesn't create a cycle
+    if(parent1 != parent2) {
+        resultList[*numEdgesSoFar] = e;
+        *numEdgesSoFar += 1;
+        unionVerts(parentRepList, depthAtVertList, e.u, e.v);
+    }
+}
+
+bool lighter(const edge &a, const edge &b) {
+    return a.w < b.w;
+}
 
+// Merges range r of every sorted block into merged[rangeStart[r], rangeStart[r+1]).
+// bounds[b][r] is where range r starts inside block b.
+void mergeRange(edge *merged, const std::vector<std::vector<int>> &bounds,
+        const std::vector<int> &rangeStart, int r) {
+    typedef std::pair<int, int> head; // (weight, block)
+    std::priority_queue<head, std::vector<head>, std::greater<head>> heads;
+    std::vector<int> pos(bounds.size());
+    for(size_t b = 0; b < bounds.size(); b++) {
+        pos[b] = bounds[b][r];
+        if(pos[b] < bounds[b][r+1]) {
+            heads.push(head(edgeList[pos[b]].w, b));
+        }
+    }
+
+    int out = rangeStart[r];
+    while(!heads.empty()) {
+        int b = heads.top().second;
+        heads.pop();
+        merged[out++] = edgeList[pos[b]++];
+        if(pos[b] < bounds[b][r+1]) {
+            heads.push(head(edgeList[pos[b]].w, b));
+        }
+    }
+}
+
+// Pipelined ingest: thread 0 parses the file into blocks of PIPELINE_BLOCK
+// edges while the other threads sort each block as soon as it is complete
+// (thread 0 joins them once it reaches the end of the file). The sorted blocks
+// are then cut into weight ranges at sampled splitters and the ranges are
+// multiway merged in parallel into merged. Thread 0 runs union-find over the
+// ranges in weight order as soon as each one is merged, merging a range itself
+// if nobody has claimed it yet, and stops the merge once targetEdges edges are
+// found. Returns the number of edges found.
+int pipelinedKruskal(FILE *input, char *inputFilename, edge *merged, int* parentRepList,
+        int* depthAtVertList, int targetEdges) {
+    int numBlocks = (m + PIPELINE_BLOCK - 1) / PIPELINE_BLOCK;
+    std::atomic<int> blocksRead(0);
+    std::atomic<int> nextSort(0);
+    std::atomic<bool> stop(false);
+    double pipeline_start = omp_get_wtime();
+    double readTime = 0;
+    double sortTime = 0;
+
+    std::vector<std::vector<int>> bounds(numBlocks);
+    std::vector<int> rangeStart;
+    std::unique_ptr<std::atomic<int>[]> rangeState; // 0 unclaimed, 1 merging, 2 merged
+    int numRanges = 0;
+    int numEdgesSoFar = 0;
+
+    #pragma omp parallel
+    {
+        int threadId = omp_get_thread_num();
+        int numThreads = omp_get_num_threads();
+
+        // READ: publish each block as soon as its last edge is parsed
+        if(threadId == 0) {
+            for(int i = 0; i < m; i++) {
+                int inputLine = fscanf(input, "%d %d %d\n", &edgeList[i].u, &edgeList[i].v, &edgeList[i].w);
+                if(inputLine != 3) {
+                    fprintf(stderr, "Input file %s is formatted incorrectly\n", inputFilename);
+                    exit(EXIT_FAILURE);
+                }
+                if((i+1) % PIPELINE_BLOCK == 0 || i+1 == m) {
+                    blocksRead.store(i / PIPELINE_BLOCK + 1, std::memory_order_release);
+                }
+            }
+            readTime = omp_get_wtime() - pipeline_start;
+        }
+
+        // SORT: claim blocks in file order as the reader finishes them
+        while(true) {
+            int b = nextSort.load();
+            if(b >= numBlocks) {
+                break;
+            }
+            if(b >= blocksRead.load(std::memory_order_acquire)) {
+                sched_yield();
+                continue;
+            }
+            if(nextSort.compare_exchange_weak(b, b+1)) {
+                std::sort(edgeList + (size_t)b*PIPELINE_BLOCK,
+                        edgeList + std::min((size_t)(b+1)*PIPELINE_BLOCK, (size_t)m), lighter);
+            }
+        }
+        #pragma omp barrier
+
+        // SPLIT: pick weight splitters from samples of every block and find
+        // where each range starts inside each block
+        #pragma omp single
+        {
+            sortTime = omp_get_wtime() - pipeline_start;
+            std::vector<int> samples;
+            for(int b = 0; b < numBlocks; b++) {
+                int start = b*PIPELINE_BLOCK;
+                int len = std::min(PIPELINE_BLOCK, m - start);
+                for(int s = 0; s < PIPELINE_SAMPLES && s < len; s++) {
+                    samples.push_back(edgeList[start + (long long)s*len/std::min(PIPELINE_SAMPLES, len)].w);
+                }
+            }
+            std::sort(samples.begin(), samples.end());
+
+            int wantedRanges = numThreads * PIPELINE_RANGES_PER_THREAD;
+            std::vector<int> splitters;
+            for(int r = 1; r < wantedRanges && !samples.empty(); r++) {
+                int w = samples[(long long)r*samples.size()/wantedRanges];
+                if(splitters.empty() || splitters.back() < w) {
+                    splitters.push_back(w);
+                }
+            }
+            numRanges = splitters.size() + 1;
+
+            // range r holds the weights in (splitters[r-1], splitters[r]]
+            rangeStart.assign(numRanges + 1, 0);
+            for(int b = 0; b < numBlocks; b++) {
+                edge *begin = edgeList + (size_t)b*PIPELINE_BLOCK;
+                edge *end = edgeList + std::min((size_t)(b+1)*PIPELINE_BLOCK, (size_t)m);
+                bounds[b].resize(numRanges + 1);
+                bounds[b][0] = begin - edgeList;
+                for(int r = 1; r < numRanges; r++) {
+                    edge key;
+                    key.w = splitters[r-1];
+                    bounds[b][r] = std::upper_bound(begin, end, key, lighter) - edgeList;
+                }
+                bounds[b][numRanges] = end - edgeList;
+                for(int r = 0; r < numRanges; r++) {
+                    rangeStart[r+1] += bounds[b][r+1] - bounds[b][r];
+                }
+            }
+            for(int r = 0; r < numRanges; r++) {
+                rangeStart[r+1] += rangeStart[r];
+            }
+            rangeState.reset(new std::atomic<int>[numRanges]);
+            for(int r = 0; r < numRanges; r++) {
+                rangeState[r].store(0);
+            }
+        }
+
+        // MERGE + UNION FIND
+        if(threadId == 0) {
+            for(int r = 0; r < numRanges && numEdgesSoFar < targetEdges; r++) {
+                int unclaimed = 0;
+                if(rangeState[r].compare_exchange_strong(unclaimed, 1)) {
+                    mergeRange(merged, bounds, rangeStart, r);
+                    rangeState[r].store(2, std::memory_order_release);
+                }
+                while(rangeState[r].load(std::memory_order_acquire) != 2) {
+                    sched_yield();
+                }
+                for(int i = rangeStart[r]; i < rangeStart[r+1] && numEdgesSoFar < targetEdges; i++) {
+                    tryUnion(parentRepList, depthAtVertList, merged[i], &numEdgesSoFar);
+                }
+            }
+            stop.store(true);
+        } else {
+            for(int r = 0; r < numRanges && !stop.load(); r++) {
+                int unclaimed = 0;
+                if(rangeState[r].compare_exchange_strong(unclaimed, 1)) {
+                    mergeRange(merged, bounds, rangeStart, r);
+                    rangeState[r].store(2, std::memory_order_release);
+                }
+            }
+        }
+    }
+    fclose(input);
+
+    printf("Read Time: %lf.\n", readTime);
+    printf("Sort Done: %lf (%d blocks, %d merge ranges).\n", sortTime, numBlocks, numRanges);
+    return numEdgesSoFar;
+}
 
 
 int main(int argc, char *argv[]) {
@@ -218,13 +487,29 @@ int main(int argc, char *argv[]) {
 
     int opt;
     char *inputFilename = NULL;
-    while((opt = getopt(argc, argv, "f:")) != -1){
+    while((opt = getopt(argc, argv, "f:cr:k:p")) != -1){
         switch(opt){
             case 'f':
                 inputFilename = optarg;
                 break;
+            case 'c':
+                dedupeInput = true;
+                break;
+            case 'r':
+                vertexOrder = parseOrder(optarg);
+                break;
+            case 'k':
+                numClusters = atoi(optarg);
+                if(numClusters < 1) {
+                    fprintf(stderr, "Number of clusters must be positive\n");
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'p':
+                pipelined = true;
+                break;
             default:
-                fprintf(stderr, "Usage: %s -f <filename>\n", argv[0]);
+                fprintf(stderr, "Usage: %s -f <filename> [-c] [-r bfs|rcm|degree] [-k clusters] [-p]\n", argv[0]);
                 exit(EXIT_FAILURE);
         }
     }
@@ -234,7 +519,19 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    readInput(inputFilename);
+    if(pipelined && (dedupeInput || vertexOrder != ORDER_NONE)) {
+        fprintf(stderr, "-p cannot be combined with -c or -r\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // the pipelined ingest parses the edges itself
+    auto run_start = Clock::now();
+    FILE *input = NULL;
+    if(pipelined) {
+        input = openInput(inputFilename);
+    } else {
+        readInput(inputFilename);
+    }
 
 
     // start time
@@ -242,62 +539,63 @@ int main(int argc, char *argv[]) {
     double compute_time = 0;
 
 
-    // UNION FIND SET UP
-    int *parentRepList = (int*)calloc(n, sizeof(int));
-    if(parentRepList == NULL) {
+    // WORKSPACE SET UP (sort scratch, union find and result, allocated once)
+    size_t workspaceSize = workspaceBytes((size_t)(2*m)*sizeof(edge) + (size_t)n*2*sizeof(int) + (size_t)n*sizeof(edge), 4);
+    void *workspaceMem = malloc(workspaceSize);
+    if(workspaceMem == NULL) {
         printf("malloc error");
         return 0;
     }
+    workspace_t workspace;
+    workspaceInit(&workspace, workspaceMem, workspaceSize);
+    edge *sortScratch = (edge*)workspaceAlloc(&workspace, (size_t)(2*m)*sizeof(edge));
+
+
+    // UNION FIND SET UP
+    int *parentRepList = (int*)workspaceAlloc(&workspace, (size_t)n*sizeof(int));
     for(int i = 0; i < n; i++) {
         parentRepList[i] = i;
     }
-    int *depthAtVertList = (int*)calloc(n, sizeof(int));
-    if(depthAtVertList == NULL) {
-        printf("malloc error");
-        return 0;
-    }
+    int *depthAtVertList = (int*)workspaceAlloc(&workspace, (size_t)n*sizeof(int));
     for(int i = 0; i < n; i++) {
         depthAtVertList[i] = 0;
     }
 
 
     // RUN KRUSKAL
-    resultList = (edge*)calloc((n-1), sizeof(edge));
+    resultList = (edge*)workspaceAlloc(&workspace, (size_t)n*sizeof(edge));
 
-    // TIME MEASURE 1 (before meerge)
-    double time1 = duration_cast<dsec>(Clock::now() - compute_start).count();
-    printf("Time1: %lf.\n", time1);
-
-    // Sort edge list (length 2*m since including undirected edges)
-    mergeSort(edgeList, 0, (2*m));
-    //printf("\nDone with merge sort\n");
+    int numEdgesSoFar = 0;
 
-    double time2 = duration_cast<dsec>(Clock::now() - compute_start).count();
-    printf("Time2: %lf.\n", time2);
-    printf("MergeTime: %lf.\n", globalTime);
+    // k clusters are left after n-k unions, so the heaviest tail of the MST
+    // is never visited
+    int targetEdges = n-1;
+    if(numClusters > 0) {
+        targetEdges = std::max(n - numClusters, 0);
+    }
 
-    int numEdgesSoFar = 0;
-    int i = 0;
-
-    // Loop until n-1 edges have been found to create the MST
-    while(numEdgesSoFar < n-1) {
-        int vert1 = edgeList[i].u;
-        int vert2 = edgeList[i].v;
-        int currW = edgeList[i].w;
-
-        int parent1 = find(parentRepList, vert1);
-        int parent2 = find(parentRepList, vert2);
-
-        // Ensure connecting vert1 and vert2 doesn't create a cycle
-        if(parent1 != parent2) {
-            resultList[numEdgesSoFar].u = vert1;
-            resultList[numEdgesSoFar].v = vert2;
-            resultList[numEdgesSoFar].w = currW;
-            numEdgesSoFar += 1;
-            unionVerts(parentRepList, depthAtVertList, vert1, vert2);
+    if(pipelined) {
+        numEdgesSoFar = pipelinedKruskal(input, inputFilename, sortScratch, parentRepList, depthAtVertList, targetEdges);
+    } else {
+        // TIME MEASURE 1 (before meerge)
+        double time1 = duration_cast<dsec>(Clock::now() - compute_start).count();
+        printf("Time1: %lf.\n", time1);
+
+        // Sort edge list (length 2*m since including undirected edges)
+        mergeSort(edgeList, sortScratch, 0, (2*m));
+        //printf("\nDone with merge sort\n");
+
+        double time2 = duration_cast<dsec>(Clock::now() - compute_start).count();
+        printf("Time2: %lf.\n", time2);
+        printf("MergeTime: %lf.\n", globalTime);
+
+        // Loop until n-1 edges have been found to create the MST (or the edges run
+        // out, if the graph is disconnected)
+        for(int i = 0; numEdgesSoFar < targetEdges && i < 2*m; i++) {
+            tryUnion(parentRepList, depthAtVertList, edgeList[i], &numEdgesSoFar);
         }
-        i+=1;
     }
+    numResultEdges = numEdgesSoFar;
 
 
     // Print out result MST
@@ -309,14 +607,21 @@ int main(int argc, char *argv[]) {
     // end time
     compute_time += duration_cast<dsec>(Clock::now() - compute_start).count();
     printf("Computation Time: %lf.\n", compute_time);
+    printf("End-to-End Time: %lf.\n", duration_cast<dsec>(Clock::now() - run_start).count());
+    printPeakMemory(&workspace);
 
 
     // Write output to a file
-    writeOutput();
+    if(numClusters > 0) {
+        if(n - numEdgesSoFar > numClusters) {
+            printf("Graph has %d components, more than the %d clusters requested.\n", n - numEdgesSoFar, numClusters);
+        }
+        writeClusters(parentRepList, n - numEdgesSoFar);
+    } else {
+        writeOutput();
+    }
     free(edgeList);
-    free(resultList);
-    free(parentRepList);
-    free(depthAtVertList);
+    free(workspaceMem);
 
 
     return 0;
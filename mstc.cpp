@@ -0,0 +1,85 @@
+/* Compile: make mstc
+ * Usage: ./mstc [-s <socket path>] <request words>...
+ *
+ * Sends one request to a running mstd and prints its response, for example
+ *
+ *   ./mstc LOAD g1 input_4_4_10.txt
+ *   ./mstc WEIGHT g1 7
+ *
+ * Exits with a failure status if the server answers with an error or closes
+ * the connection without answering.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <string>
+
+int main(int argc, char *argv[]){
+	int opt;
+	const char *socketPath = "/tmp/mstd.sock";
+
+	// stop at the first request word so that it is not taken as an option
+	while((opt = getopt(argc, argv, "+s:")) != -1){
+		switch(opt){
+			case 's':
+				socketPath = optarg;
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-s <socket path>] <request words>...\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if(optind == argc){
+		fprintf(stderr, "A request is required\n");
+		exit(EXIT_FAILURE);
+	}
+
+	std::string request;
+	for(int i = optind; i < argc; i++){
+		request += argv[i];
+		request += i + 1 < argc ? " " : "\n";
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(socketPath) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "Socket path %s is too long\n", socketPath);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(addr.sun_path, socketPath);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0){
+		fprintf(stderr, "Unable to connect to %s\n", socketPath);
+		exit(EXIT_FAILURE);
+	}
+	if(write(fd, request.data(), request.size()) != (ssize_t)request.size()){
+		fprintf(stderr, "Unable to send request\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// the server closes the connection once the response is complete
+	char buf[1 << 16];
+	ssize_t got;
+	bool first = true;
+	bool failed = false;
+	while((got = read(fd, buf, sizeof(buf))) > 0){
+		if(first && got >= 3 && strncmp(buf, "ERR", 3) == 0){
+			failed = true;
+		}
+		first = false;
+		fwrite(buf, 1, got, stdout);
+	}
+	close(fd);
+	if(first){
+		fprintf(stderr, "No response from %s\n", socketPath);
+		failed = true;
+	}
+
+	return failed ? EXIT_FAILURE : 0;
+}
@@ -0,0 +1,427 @@
+/* Compile: make mstd
+ * Usage: ./mstd [-s <socket path>] [-n <num_threads>] [-g <name>=<filename>]...
+ *
+ * Resident MST server. Graphs are mapped and parsed once, their edges are kept
+ * sorted by weight, and requests are answered over a Unix-domain socket (by
+ * default /tmp/mstd.sock). Each connection carries one request line and gets
+ * one response, after which the server closes it; mstc is a client for it.
+ *
+ * Requests:
+ *   LOAD <graph> <filename>      load or reload a graph, dropping its cache
+ *   UNLOAD <graph>               forget a graph
+ *   LIST                         list loaded graphs
+ *   MST <graph> [<maxWeight>]    minimum spanning forest, optionally of the
+ *                                edges with w <= maxWeight
+ *   WEIGHT <graph> [<maxWeight>] as MST, but only the summary line
+ *   SUBSET <graph> <v> <v> ...   minimum spanning forest of the subgraph
+ *                                induced by the given vertices
+ *   SHUTDOWN                     stop the server
+ *
+ * Responses start with "OK" or "ERR <message>". MST, WEIGHT and SUBSET answer
+ * "OK <n> <number of tree edges> <weight>" followed, except for WEIGHT, by one
+ * "<v1> <v2> <w>" line per tree edge.
+ *
+ * Kruskal over a weight-sorted edge list only ever looks at a prefix of it, so
+ * the minimum spanning forest of the edges with w <= X is exactly the prefix of
+ * the full forest with w <= X. Each graph therefore caches its full forest and
+ * the running weight along it, and every weight-capped query is answered from
+ * that cache with a binary search. Reloading a graph replaces it along with its
+ * cache; queries already running keep the old copy until they finish.
+ *
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <bits/stdc++.h>
+#include <parallel/algorithm>
+#include <omp.h>
+#include <chrono>
+#include "spanning_forest.h"
+
+/* A loaded graph. The edge list never changes after loading; the cached
+ * forest is filled in by the first query that needs it. */
+typedef struct loaded_graph {
+	std::string filename;
+	unsigned int n;
+	std::vector<edge_t> edges;           // sorted by weight
+	std::mutex cacheLock;
+	bool cached;
+	std::vector<edge_t> forest;          // minimum spanning forest, sorted by weight
+	std::vector<long long> prefixWeight; // prefixWeight[i] = weight of forest[0, i)
+} loaded_graph_t;
+
+std::map<std::string, std::shared_ptr<loaded_graph_t>> graphs;
+std::mutex graphsLock;
+int num_threads = 1;
+const char *socketPath = "/tmp/mstd.sock";
+int listenFd = -1;
+std::atomic<bool> stopping(false);
+
+/* @brief Parses the next non-negative or negative integer in [*p, end),
+ * rejecting numbers that do not fit in a long */
+bool parseNumber(const char **p, const char *end, long *value){
+	const char *q = *p;
+	while(q < end && isspace((unsigned char)*q)){
+		q++;
+	}
+	bool negative = false;
+	if(q < end && *q == '-'){
+		negative = true;
+		q++;
+	}
+	if(q == end || !isdigit((unsigned char)*q)){
+		return false;
+	}
+	// accumulate towards the negative side, which holds one more value
+	long v = 0;
+	while(q < end && isdigit((unsigned char)*q)){
+		int digit = *q - '0';
+		if(v < (LONG_MIN + digit) / 10){
+			return false;
+		}
+		v = v * 10 - digit;
+		q++;
+	}
+	if(!negative && v == LONG_MIN){
+		return false;
+	}
+	*value = negative ? v : -v;
+	*p = q;
+	return true;
+}
+
+/* @brief Parses a whole request word as an integer */
+bool parseToken(const std::string &token, long *value){
+	const char *p = token.data();
+	const char *end = p + token.size();
+	return parseNumber(&p, end, value) && p == end;
+}
+
+/* @brief Maps and parses a graph file and sorts its edges by weight. Returns
+ * NULL and fills err if the file cannot be used. */
+std::shared_ptr<loaded_graph_t> loadGraph(const std::string &filename, std::string &err){
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0){
+		err = "unable to open " + filename;
+		return NULL;
+	}
+	struct stat st;
+	if(fstat(fd, &st) != 0 || st.st_size == 0){
+		close(fd);
+		err = "unable to read " + filename;
+		return NULL;
+	}
+	void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(mem == MAP_FAILED){
+		err = "unable to map " + filename;
+		return NULL;
+	}
+	madvise(mem, st.st_size, MADV_SEQUENTIAL);
+
+	const char *p = (const char *)mem;
+	const char *end = p + st.st_size;
+	std::shared_ptr<loaded_graph_t> g = std::make_shared<loaded_graph_t>();
+	g->filename = filename;
+	g->cached = false;
+
+	long n, m, maxWeight;
+	// every edge line takes at least "0 0 0\n" (the last one may lack the
+	// newline), so a larger m cannot be right and must not be allocated
+	bool ok = parseNumber(&p, end, &n) && parseNumber(&p, end, &m) && parseNumber(&p, end, &maxWeight)
+		&& n >= 0 && m >= 0 && m <= (end - p + 1) / 6 && n <= UINT_MAX;
+	if(ok){
+		g->n = n;
+		g->edges.resize(m);
+		for(long i = 0; i < m && ok; i++){
+			long v1, v2, w;
+			ok = parseNumber(&p, end, &v1) && parseNumber(&p, end, &v2) && parseNumber(&p, end, &w)
+				&& v1 >= 0 && v2 >= 0 && v1 < n && v2 < n;
+			g->edges[i].v1 = v1;
+			g->edges[i].v2 = v2;
+			g->edges[i].w = w;
+		}
+	}
+	munmap(mem, st.st_size);
+	if(!ok){
+		err = filename + " is formatted incorrectly";
+		return NULL;
+	}
+
+	__gnu_parallel::stable_sort(g->edges.begin(), g->edges.end(), [](const edge_t &a, const edge_t &b){
+		return a.w < b.w;
+	}, __gnu_parallel::default_parallel_tag(num_threads));
+	return g;
+}
+
+/* @brief Runs Kruskal over the weight-sorted edges, keeping only edges whose
+ * endpoints are both in the given vertex set (all vertices if it is empty) */
+long long kruskal(const loaded_graph_t &g, const std::vector<char> &inSet, std::vector<edge_t> &forest){
+	std::vector<unsigned int> parent;
+	std::vector<unsigned char> rank;
+	return spanningForest(g.edges.data(), g.edges.size(), g.n, inSet, parent, rank, forest);
+}
+
+/* @brief Computes the full forest of a graph unless it is already cached */
+void ensureForest(loaded_graph_t &g){
+	std::lock_guard<std::mutex> guard(g.cacheLock);
+	if(g.cached){
+		return;
+	}
+	kruskal(g, std::vector<char>(), g.forest);
+	g.prefixWeight.assign(g.forest.size() + 1, 0);
+	for(size_t i = 0; i < g.forest.size(); i++){
+		g.prefixWeight[i + 1] = g.prefixWeight[i] + g.forest[i].w;
+	}
+	g.cached = true;
+}
+
+/* @brief Appends a forest summary line and optionally its edges to out */
+void writeForest(std::string &out, unsigned int n, const edge_t *forest, size_t count,
+		long long weight, bool withEdges){
+	char line[96];
+	snprintf(line, sizeof(line), "OK %u %zu %lld\n", n, count, weight);
+	out += line;
+	if(withEdges){
+		for(size_t i = 0; i < count; i++){
+			snprintf(line, sizeof(line), "%u %u %d\n", forest[i].v1, forest[i].v2, forest[i].w);
+			out += line;
+		}
+	}
+}
+
+/* @brief Looks up a loaded graph by name */
+std::shared_ptr<loaded_graph_t> findGraph(const std::string &name){
+	std::lock_guard<std::mutex> guard(graphsLock);
+	auto it = graphs.find(name);
+	if(it == graphs.end()){
+		return NULL;
+	}
+	return it->second;
+}
+
+/* @brief Executes one request line and returns the response. Sets stopRequested
+ * when the server should stop. */
+std::string handleRequest(const std::string &request, bool *stopRequested){
+	std::istringstream in(request);
+	std::string command, name;
+	in >> command;
+
+	if(command == "SHUTDOWN"){
+		*stopRequested = true;
+		return "OK\n";
+	}
+	if(command == "LIST"){
+		std::string out = "OK\n";
+		std::lock_guard<std::mutex> guard(graphsLock);
+		for(auto &entry : graphs){
+			char line[64];
+			snprintf(line, sizeof(line), " %u %zu ", entry.second->n, entry.second->edges.size());
+			out += entry.first + line + entry.second->filename + "\n";
+		}
+		return out;
+	}
+
+	if(!(in >> name)){
+		return "ERR missing graph name\n";
+	}
+
+	if(command == "LOAD"){
+		std::string filename, err;
+		if(!(in >> filename)){
+			return "ERR missing filename\n";
+		}
+		auto start = std::chrono::high_resolution_clock::now();
+		std::shared_ptr<loaded_graph_t> g = loadGraph(filename, err);
+		if(!g){
+			return "ERR " + err + "\n";
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		bool reloaded;
+		{
+			std::lock_guard<std::mutex> guard(graphsLock);
+			reloaded = graphs.count(name) > 0;
+			graphs[name] = g;
+		}
+		char line[128];
+		snprintf(line, sizeof(line), "OK %u %zu %s in %lf\n", g->n, g->edges.size(),
+				reloaded ? "reloaded" : "loaded", seconds);
+		return line;
+	}
+	if(command == "UNLOAD"){
+		std::lock_guard<std::mutex> guard(graphsLock);
+		if(graphs.erase(name) == 0){
+			return "ERR no graph " + name + "\n";
+		}
+		return "OK\n";
+	}
+
+	std::shared_ptr<loaded_graph_t> g = findGraph(name);
+	if(!g){
+		return "ERR no graph " + name + "\n";
+	}
+
+	std::string out;
+	if(command == "MST" || command == "WEIGHT"){
+		long maxWeight = 0;
+		bool capped = false;
+		std::string capText, extra;
+		if(in >> capText){
+			if(!parseToken(capText, &maxWeight) || in >> extra){
+				return "ERR bad maxWeight\n";
+			}
+			capped = true;
+		}
+
+		ensureForest(*g);
+		size_t count = g->forest.size();
+		if(capped){
+			// the forest of the edges with w <= maxWeight is a prefix of the full one
+			count = std::upper_bound(g->forest.begin(), g->forest.end(), maxWeight,
+					[](long w, const edge_t &e){ return w < e.w; }) - g->forest.begin();
+		}
+		writeForest(out, g->n, g->forest.data(), count, g->prefixWeight[count], command == "MST");
+		return out;
+	}
+	if(command == "SUBSET"){
+		std::vector<char> inSet(g->n, 0);
+		std::string vertexText;
+		while(in >> vertexText){
+			long v;
+			if(!parseToken(vertexText, &v)){
+				return "ERR bad vertex " + vertexText + "\n";
+			}
+			if(v < 0 || v >= (long)g->n){
+				return "ERR vertex out of range\n";
+			}
+			inSet[v] = 1;
+		}
+		std::vector<edge_t> forest;
+		long long weight = kruskal(*g, inSet, forest);
+		writeForest(out, g->n, forest.data(), forest.size(), weight, true);
+		return out;
+	}
+	return "ERR unknown command " + command + "\n";
+}
+
+/* @brief Reads one request from a client, answers it and closes the connection */
+void serveClient(int fd){
+	std::string request;
+	char buf[4096];
+	ssize_t got;
+	while((got = read(fd, buf, sizeof(buf))) > 0){
+		request.append(buf, got);
+		if(request.find('\n') != std::string::npos){
+			break;
+		}
+	}
+	request = request.substr(0, request.find('\n'));
+
+	bool stopRequested = false;
+	std::string response = handleRequest(request, &stopRequested);
+	size_t sent = 0;
+	while(sent < response.size()){
+		ssize_t n = write(fd, response.data() + sent, response.size() - sent);
+		if(n <= 0){
+			break;
+		}
+		sent += n;
+	}
+	close(fd);
+
+	// wake the accept loop in main, which tears the server down
+	if(stopRequested){
+		stopping.store(true);
+		shutdown(listenFd, SHUT_RDWR);
+	}
+}
+
+int main(int argc, char *argv[]){
+	int opt;
+	std::vector<std::string> preload;
+
+	while((opt = getopt(argc, argv, "s:n:g:")) != -1){
+		switch(opt){
+			case 's':
+				socketPath = optarg;
+				break;
+			case 'n':
+				num_threads = std::max(atoi(optarg), 1);
+				break;
+			case 'g':
+				preload.push_back(optarg);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-s <socket path>] [-n <num_threads>] [-g <name>=<filename>]...\n", argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	for(auto &spec : preload){
+		size_t eq = spec.find('=');
+		if(eq == std::string::npos){
+			fprintf(stderr, "Graph %s must be given as <name>=<filename>\n", spec.c_str());
+			exit(EXIT_FAILURE);
+		}
+		bool stopRequested;
+		std::string response = handleRequest("LOAD " + spec.substr(0, eq) + " " + spec.substr(eq + 1), &stopRequested);
+		printf("%s: %s", spec.substr(0, eq).c_str(), response.c_str());
+		if(response.compare(0, 2, "OK") != 0){
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(socketPath) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "Socket path %s is too long\n", socketPath);
+		exit(EXIT_FAILURE);
+	}
+	strcpy(addr.sun_path, socketPath);
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listenFd < 0){
+		fprintf(stderr, "Unable to create socket\n");
+		exit(EXIT_FAILURE);
+	}
+	unlink(socketPath);
+	if(bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listenFd, 64) != 0){
+		fprintf(stderr, "Unable to listen on %s\n", socketPath);
+		exit(EXIT_FAILURE);
+	}
+	// clients that hang up early must not take the server down
+	signal(SIGPIPE, SIG_IGN);
+	printf("Listening on %s.\n", socketPath);
+	fflush(stdout);
+
+	while(!stopping.load()){
+		int fd = accept(listenFd, NULL, NULL);
+		if(fd < 0){
+			if(stopping.load() || errno == EINTR || errno == ECONNABORTED){
+				continue;
+			}
+			// out of descriptors or memory: wait for connections to finish
+			// rather than spinning on the same error
+			fprintf(stderr, "Unable to accept a connection: %s\n", strerror(errno));
+			sleep(1);
+			continue;
+		}
+		std::thread(serveClient, fd).detach();
+	}
+
+	close(listenFd);
+	unlink(socketPath);
+	fflush(stdout);
+	// other connection threads may still be reading the graphs, so skip the
+	// static destructors that would free them
+	_exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,69 @@
+/* Sequential spanning forest shared by batch and mstd.
+ *
+ * Both tools keep many independent graphs and solve each one on a single
+ * thread, so they share the edge layout and a plain union-find Kruskal over an
+ * edge list that is already sorted by weight. The union-find buffers are
+ * passed in so that a caller solving graph after graph can reuse them.
+ *
+ */
+#ifndef SPANNING_FOREST_H
+#define SPANNING_FOREST_H
+
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+typedef struct edge {
+	unsigned int v1;
+	unsigned int v2;
+	int w;
+} edge_t;
+
+/* @brief Returns the representative of v, halving the path on the way */
+static inline unsigned int findParent(std::vector<unsigned int> &parent, unsigned int v){
+	while(parent[v] != v){
+		parent[v] = parent[parent[v]];
+		v = parent[v];
+	}
+	return v;
+}
+
+/* @brief Runs Kruskal over edges[0, m), which must be sorted by weight, and
+ * replaces forest with the tree edges found. Edges with an endpoint outside
+ * inSet are skipped unless inSet is empty. Returns the weight of the forest. */
+static inline long long spanningForest(const edge_t *edges, size_t m, unsigned int n,
+		const std::vector<char> &inSet, std::vector<unsigned int> &parent,
+		std::vector<unsigned char> &rank, std::vector<edge_t> &forest){
+	parent.resize(n);
+	rank.assign(n, 0);
+	for(unsigned int v = 0; v < n; v++){
+		parent[v] = v;
+	}
+
+	forest.clear();
+	long long weight = 0;
+	for(size_t i = 0; i < m && forest.size() + 1 < n; i++){
+		const edge_t &e = edges[i];
+		if(!inSet.empty() && (!inSet[e.v1] || !inSet[e.v2])){
+			continue;
+		}
+		unsigned int p1 = findParent(parent, e.v1);
+		unsigned int p2 = findParent(parent, e.v2);
+		if(p1 == p2){
+			continue;
+		}
+		// union by rank keeps the trees below log2(n) levels, so a byte suffices
+		if(rank[p1] < rank[p2]){
+			std::swap(p1, p2);
+		}
+		parent[p2] = p1;
+		if(rank[p1] == rank[p2]){
+			rank[p1]++;
+		}
+		forest.push_back(e);
+		weight += e.w;
+	}
+	return weight;
+}
+
+#endif
@@ -0,0 +1,75 @@
+/* Workspace arena shared by the MST engines.
+ *
+ * A workspace is a single block of memory sized once per run from n and m.
+ * Scratch buffers are carved out of it with workspaceAlloc and given back by
+ * resetting to an earlier mark, so no allocator calls happen inside the sort
+ * or the Boruvka rounds. The caller owns the backing memory, which lets an
+ * engine choose how its pages are placed.
+ *
+ */
+#ifndef WORKSPACE_H
+#define WORKSPACE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+#define WORKSPACE_ALIGN 64
+
+typedef struct workspace {
+	char *base;
+	size_t capacity;
+	size_t used;
+	size_t peak;
+} workspace_t;
+
+/* @brief Returns the number of bytes to reserve for the given buffer sizes,
+ * including alignment padding for each buffer */
+static inline size_t workspaceBytes(size_t bytes, size_t numBuffers){
+	return bytes + numBuffers * WORKSPACE_ALIGN;
+}
+
+/* @brief Initializes a workspace over caller-owned memory */
+static inline void workspaceInit(workspace_t *ws, void *mem, size_t capacity){
+	ws->base = (char *)mem;
+	ws->capacity = capacity;
+	ws->used = 0;
+	ws->peak = 0;
+}
+
+/* @brief Carves an aligned buffer out of the workspace */
+static inline void *workspaceAlloc(workspace_t *ws, size_t bytes){
+	size_t offset = (ws->used + WORKSPACE_ALIGN - 1) & ~(size_t)(WORKSPACE_ALIGN - 1);
+	if(offset + bytes > ws->capacity){
+		fprintf(stderr, "Workspace exhausted: %zu bytes requested, %zu of %zu in use\n",
+				bytes, ws->used, ws->capacity);
+		exit(EXIT_FAILURE);
+	}
+	ws->used = offset + bytes;
+	if(ws->used > ws->peak){
+		ws->peak = ws->used;
+	}
+	return ws->base + offset;
+}
+
+/* @brief Returns a mark that a later workspaceReset can roll back to */
+static inline size_t workspaceMark(const workspace_t *ws){
+	return ws->used;
+}
+
+/* @brief Releases every buffer allocated since the given mark */
+static inline void workspaceReset(workspace_t *ws, size_t mark){
+	ws->used = mark;
+}
+
+/* @brief Prints the workspace high-water mark and the peak resident set size
+ * of the process */
+static inline void printPeakMemory(const workspace_t *ws){
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	printf("Workspace Peak: %.2lf MB.\n", ws->peak / (1024.0 * 1024.0));
+	// ru_maxrss is reported in kilobytes on Linux
+	printf("Peak Memory: %.2lf MB.\n", usage.ru_maxrss / 1024.0);
+}
+
+#endif